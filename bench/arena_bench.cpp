@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+
+#include "dag/arena_resource.h"
+#include "dag/dag_factory.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Leaf {
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+  Leaf(std::size_t n, const allocator_type &alloc)
+      : values(n, 1, alloc), name("a leaf long enough to leave the small string buffer", alloc) {}
+  std::pmr::vector<int> values;
+  std::pmr::string name;
+};
+
+struct Hub {
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+  explicit Hub(const allocator_type &alloc) : leaves(alloc) {}
+  std::pmr::vector<Leaf *> leaves;
+};
+
+template <typename T>
+struct Wide : public dag::Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  Wide(std::size_t nodes, std::size_t width) : m_nodes(nodes), m_width(width) {}
+  std::size_t m_nodes;
+  std::size_t m_width;
+
+  Hub &hub() {
+    auto &h = make_node<Hub>();
+    for (std::size_t i = 0; i < m_nodes; ++i) {
+      h.leaves.push_back(&leaf());
+    }
+    return h;
+  }
+  Leaf &leaf() { return make_node<Leaf>(m_width); }
+};
+
+double millis(Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+void run(const char *label, std::pmr::memory_resource *memory, Clock::duration reserve,
+         std::size_t nodes, std::size_t width, int passes) {
+  auto factory = dag::DagFactory<Wide>(memory);
+  auto start = Clock::now();
+  auto root = factory.create([](auto bp) -> auto & { return bp->hub(); }, nodes, width);
+  auto built = Clock::now();
+
+  long long sum = 0;
+  for (int pass = 0; pass < passes; ++pass) {
+    for (Leaf *leaf : root->leaves) {
+      for (int v : leaf->values) {
+        sum += v;
+      }
+    }
+  }
+  auto traversed = Clock::now();
+  std::printf("%-22s reserve %8.2f ms  create %8.2f ms  traverse %8.2f ms  (checksum %lld)\n",
+              label, millis(reserve), millis(built - start), millis(traversed - built), sum);
+}
+
+template <typename F>
+void withArena(const char *label, dag::ArenaOptions options, std::size_t capacity, F fn) {
+  auto start = Clock::now();
+  dag::ArenaResource arena(capacity, options);
+  auto reserved = Clock::now();
+  fn(label, &arena, reserved - start);
+}
+}  // namespace
+
+int main() {
+  const std::size_t nodes = 200000;
+  const std::size_t width = 64;
+  const int passes = 20;
+  const std::size_t capacity = std::size_t{256} << 20;
+
+  auto bench = [&](const char *label, std::pmr::memory_resource *memory, Clock::duration reserve) {
+    run(label, memory, reserve, nodes, width, passes);
+  };
+
+  std::printf("%zu nodes of %zu ints, %d traversal passes\n", nodes, width, passes);
+  bench("default resource", std::pmr::get_default_resource(), Clock::duration::zero());
+  withArena("arena", dag::ArenaOptions{false, false}, capacity, bench);
+  withArena("arena + prefault", dag::ArenaOptions{false, true}, capacity, bench);
+  withArena("arena + huge pages", dag::ArenaOptions{true, true}, capacity, bench);
+  return 0;
+}
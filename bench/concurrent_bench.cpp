@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+#include "dag/dag_factory.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct A {};
+struct B {
+  explicit B(A &a) {}
+};
+struct C {
+  C(A &a, B &b) {}
+};
+struct D {
+  D(B &b, C &c) {}
+};
+
+template <typename T>
+struct System : public dag::Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  A &a() { return make_node<A>(); }
+  B &b() dag_shared { return make_node<B>(a()); }
+  C &c() { return make_node<C>(a(), b()); }
+  D &d() { return make_node<D>(b(), c()); }
+};
+
+struct CountingIntercepter : public dag::DefaultIntercepter {
+  long long called = 0;
+  template <typename T>
+  dag::unique_ptr<T> after_create(std::pmr::memory_resource *memory, dag::unique_ptr<T> v) {
+    ++called;
+    return std::move(v);
+  }
+};
+
+double run(unsigned threads, int graphs) {
+  dag::PerThread<std::pmr::synchronized_pool_resource> memory;
+  dag::PerThread<CountingIntercepter> intercepter;
+  auto factory =
+      dag::DagFactory<System, dag::Select<A>, dag::PerThread<CountingIntercepter>>(memory,
+                                                                                  intercepter);
+  std::atomic<unsigned> ready{0};
+  std::vector<std::thread> workers;
+  auto start = Clock::now();
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back([&] {
+      ++ready;
+      while (ready < threads) {
+        std::this_thread::yield();
+      }
+      for (int j = 0; j < graphs; ++j) {
+        auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  long long called = 0;
+  intercepter.for_each([&](CountingIntercepter &local) { called += local.called; });
+  if (called != static_cast<long long>(threads) * graphs * 5) {
+    std::printf("unexpected intercepter count %lld\n", called);
+  }
+  return threads * graphs / seconds;
+}
+}  // namespace
+
+int main() {
+  const int graphs = 200000;
+  const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  double single = 0;
+  std::printf("%8s %16s %10s\n", "threads", "graphs/s", "speedup");
+  // doubles the thread count, ending on maxThreads even when it is not a power of two.
+  for (unsigned threads = 1; threads <= maxThreads;
+       threads = threads == maxThreads ? maxThreads + 1 : std::min(threads * 2, maxThreads)) {
+    double throughput = run(threads, graphs);
+    single = threads == 1 ? throughput : single;
+    std::printf("%8u %16.0f %10.2f\n", threads, throughput, throughput / single);
+  }
+  return 0;
+}
@@ -0,0 +1,212 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2024, Darklen84
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace dag {
+
+struct ArenaOptions {
+  // Back the region with huge pages: MAP_HUGETLB first, then transparent huge pages via
+  // madvise(MADV_HUGEPAGE). Ignored where the platform does not support it.
+  bool huge_pages = false;
+  // Fault every page in when the region is reserved, so construction does not pay for it.
+  bool prefault = false;
+};
+
+// A bump-pointer memory_resource over one region reserved up front, meant to hold a large,
+// long-lived DAG. Deallocation is a no-op except that the region is rewound once every
+// allocation has been returned, so the next DAG built on it reuses the already-faulted pages.
+// The region itself is unmapped when the resource is destroyed. Requests that do not fit are
+// forwarded to `upstream`. Like std::pmr::monotonic_buffer_resource, it is not thread-safe.
+class ArenaResource : public std::pmr::memory_resource {
+ public:
+  explicit ArenaResource(std::size_t capacity, ArenaOptions options = {},
+                         std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : m_upstream(upstream) {
+    reserve(capacity, options);
+  }
+  ArenaResource(const ArenaResource &) = delete;
+  ArenaResource &operator=(const ArenaResource &) = delete;
+  ~ArenaResource() override { unreserve(); }
+
+  std::byte *data() const { return m_begin; }
+  std::size_t capacity() const { return m_capacity; }
+  std::size_t used() const { return m_offset; }
+  bool huge_pages() const { return m_hugePages; }
+  // allocations that did not fit and are still held by upstream.
+  std::size_t spilled() const { return m_spilled; }
+  bool owns(const void *p) const {
+    auto b = reinterpret_cast<std::uintptr_t>(m_begin);
+    auto a = reinterpret_cast<std::uintptr_t>(p);
+    return a >= b && a < b + m_capacity;
+  }
+
+ protected:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    std::size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+    if (m_begin == nullptr || start + bytes > m_capacity || start + bytes < start) {
+      void *p = m_upstream->allocate(bytes, alignment);
+      ++m_spilled;
+      return p;
+    }
+    m_offset = start + bytes;
+    ++m_live;
+    return m_begin + start;
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+    if (!owns(p)) {
+      m_upstream->deallocate(p, bytes, alignment);
+      --m_spilled;
+      return;
+    }
+    if (--m_live == 0) {
+      m_offset = 0;
+    }
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+ private:
+  static std::size_t pageSize() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+  }
+
+  static std::size_t roundUp(std::size_t n, std::size_t unit) {
+    return (n + unit - 1) / unit * unit;
+  }
+
+  void reserve(std::size_t capacity, ArenaOptions options) {
+    if (capacity == 0) {
+      return;
+    }
+#if defined(_WIN32)
+    m_mapped = roundUp(capacity, pageSize());
+    void *p = VirtualAlloc(nullptr, m_mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (p == nullptr) {
+      throw std::bad_alloc();
+    }
+    m_mapping = p;
+    m_begin = static_cast<std::byte *>(p);
+    m_capacity = m_mapped;
+#else
+    constexpr std::size_t hugePage = std::size_t{2} << 20;
+    int populate = 0;
+#if defined(MAP_POPULATE)
+    populate = options.prefault ? MAP_POPULATE : 0;
+#endif
+    void *p = MAP_FAILED;
+    bool populated = false;
+#if defined(MAP_HUGETLB)
+    if (options.huge_pages) {
+      m_mapped = roundUp(capacity, hugePage);
+      p = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+      m_hugePages = p != MAP_FAILED;
+      populated = m_hugePages && populate != 0;
+    }
+#endif
+    if (p == MAP_FAILED) {
+      // Over-reserve so the usable region can start on a huge page boundary, which is what
+      // transparent huge pages need to back it.
+      std::size_t slack = options.huge_pages ? hugePage : 0;
+      // Populating here would fault in small pages before madvise() gets a chance to run.
+      int flags = MAP_PRIVATE | MAP_ANONYMOUS | (options.huge_pages ? 0 : populate);
+      m_mapped = roundUp(capacity, pageSize()) + slack;
+      p = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      populated = !options.huge_pages && populate != 0;
+    }
+    m_mapping = p;
+    auto addr = reinterpret_cast<std::uintptr_t>(p);
+    std::uintptr_t begin = m_hugePages || !options.huge_pages ? addr : roundUp(addr, hugePage);
+    m_begin = reinterpret_cast<std::byte *>(begin);
+    m_capacity = m_mapped - (begin - addr);
+#if defined(MADV_HUGEPAGE)
+    if (options.huge_pages && !m_hugePages) {
+      m_hugePages = madvise(m_begin, m_capacity, MADV_HUGEPAGE) == 0;
+    }
+#endif
+    if (populated) {
+      return;
+    }
+#endif
+    if (options.prefault) {
+      std::size_t step = pageSize();
+      for (std::size_t i = 0; i < m_capacity; i += step) {
+        reinterpret_cast<volatile std::byte *>(m_begin)[i] = std::byte{0};
+      }
+    }
+  }
+
+  void unreserve() {
+    if (m_mapping == nullptr) {
+      return;
+    }
+#if defined(_WIN32)
+    VirtualFree(m_mapping, 0, MEM_RELEASE);
+#else
+    munmap(m_mapping, m_mapped);
+#endif
+    m_mapping = nullptr;
+  }
+
+  std::pmr::memory_resource *m_upstream;
+  void *m_mapping = nullptr;
+  std::size_t m_mapped = 0;
+  std::byte *m_begin = nullptr;
+  std::size_t m_capacity = 0;
+  std::size_t m_offset = 0;
+  std::size_t m_live = 0;
+  std::size_t m_spilled = 0;
+  bool m_hugePages = false;
+};
+}  // namespace dag
@@ -25,13 +25,27 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <memory_resource>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
-#pragma one
+#pragma once
 
 namespace dag {
 using deleter = std::function<void(void *)>;
@@ -39,18 +53,170 @@ using deleter = std::function<void(void *)>;
 template <typename T>
 using unique_ptr = std::unique_ptr<T, deleter>;
 
+template <typename T, typename... Args>
+unique_ptr<T> make_unique_on_memory(std::pmr::memory_resource *memory, Args &&...args) {
+  std::pmr::polymorphic_allocator<T> alloc{memory};
+  T *raw = alloc.allocate(1);
+  alloc.construct(raw, std::forward<Args>(args)...);
+  return unique_ptr<T>(raw, [alloc](void *p) mutable {  // NOSONAR
+    auto obj = static_cast<T *>(p);
+    alloc.destroy(obj);
+    alloc.deallocate(obj, 1);
+  });
+}
+
 template <typename TypeToSelect>
 struct DagContext;
 
+template <typename T>
+std::string_view type_name() {
+#if defined(_MSC_VER)
+  std::string_view name = __FUNCSIG__;
+  std::size_t begin = name.find("type_name<") + 10;
+  std::size_t end = name.rfind(">(void)");
+#else
+  std::string_view name = __PRETTY_FUNCTION__;
+  std::size_t begin = name.find("T = ") + 4;
+  std::size_t end = name.find_first_of(";]", begin);
+#endif
+  return name.substr(begin, end - begin);
+}
+
+template <typename T>
+const void *type_key() {
+  static const char key = 0;
+  return &key;
+}
+
+// Names a node for the index: make_node<T>(dag::Tag{"metrics"}, args...).
+struct Tag {
+  std::string_view name;
+};
+
+template <typename T>
+class NodeRange {
+ public:
+  struct iterator {
+    void *const *pos;
+    T &operator*() const { return *static_cast<T *>(*pos); }
+    iterator &operator++() {
+      ++pos;
+      return *this;
+    }
+    bool operator==(const iterator &other) const { return pos == other.pos; }
+    bool operator!=(const iterator &other) const { return pos != other.pos; }
+  };
+  NodeRange() = default;
+  NodeRange(void *const *begin, void *const *end) : m_begin(begin), m_end(end) {}
+  iterator begin() const { return {m_begin}; }
+  iterator end() const { return {m_end}; }
+  std::size_t size() const { return static_cast<std::size_t>(m_end - m_begin); }
+  bool empty() const { return m_begin == m_end; }
+  T &operator[](std::size_t i) const { return *static_cast<T *>(m_begin[i]); }
+
+ private:
+  void *const *m_begin = nullptr;
+  void *const *m_end = nullptr;
+};
+
+// Nodes of a dag by type and by tag, stored on the dag's memory. Types are matched exactly, so a
+// node made with make_node<Derived>() is not found as a Base. Tags are copied once, so that looking
+// one up allocates nothing.
+class NodeIndex {
+ public:
+  explicit NodeIndex(std::pmr::memory_resource *memory)
+      : m_byType(memory), m_byTag(memory), m_tags(memory) {}
+
+  template <typename T>
+  void add(T *node, std::string_view tag) {
+    m_byType[type_key<T>()].push_back(node);
+    if (!tag.empty()) {
+      auto found = m_byTag.find(tag);
+      if (found == m_byTag.end()) {
+        // a deque never moves its elements, so the key keeps pointing at the copy.
+        std::string_view key = m_tags.emplace_back(tag);
+        found = m_byTag.try_emplace(key).first;
+      }
+      found->second.emplace_back(type_key<T>(), node);
+    }
+  }
+
+  template <typename T>
+  T *find(std::string_view tag) const {
+    if (tag.empty()) {
+      auto found = m_byType.find(type_key<T>());
+      return found == m_byType.end() ? nullptr : static_cast<T *>(found->second.front());
+    }
+    auto found = m_byTag.find(tag);
+    if (found != m_byTag.end()) {
+      for (auto &[type, node] : found->second) {
+        if (type == type_key<T>()) {
+          return static_cast<T *>(node);
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  template <typename T>
+  NodeRange<T> all() const {
+    auto found = m_byType.find(type_key<T>());
+    if (found == m_byType.end()) {
+      return {};
+    }
+    return {found->second.data(), found->second.data() + found->second.size()};
+  }
+
+ private:
+  std::pmr::unordered_map<const void *, std::pmr::vector<void *>> m_byType;
+  std::pmr::unordered_map<std::string_view, std::pmr::vector<std::pair<const void *, void *>>>
+      m_byTag;
+  std::pmr::deque<std::pmr::string> m_tags;
+};
+
+// The part of a dag that does not depend on what it selects. graph_of() reaches it from the root
+// returned by DagFactory::create(). find() and all() only see nodes when the factory that built the
+// dag has the index enabled; find() without a tag returns the first node of that type.
+struct DagBase {
+  template <typename T>
+  T *find(std::string_view tag = {}) const {
+    return m_index == nullptr ? nullptr : m_index->find<T>(tag);
+  }
+  template <typename T>
+  NodeRange<T> all() const {
+    return m_index == nullptr ? NodeRange<T>() : m_index->all<T>();
+  }
+  virtual ~DagBase() = default;
+
+ protected:
+  friend struct DagDeleter;
+  DagBase() = default;
+  virtual void release(void *root) = 0;
+
+  unique_ptr<NodeIndex> m_index;
+};
+
 template <typename TypeToSelect>
-struct Dag {
+struct Dag : public DagBase {
   virtual const std::pmr::vector<TypeToSelect *> &selections() const = 0;
-  virtual ~Dag() = default;
+  ~Dag() override = default;
 
  protected:
   Dag() = default;
 };
 
+// Deleter of the root returned by DagFactory::create(); releasing the root releases its dag.
+struct DagDeleter {
+  DagBase *dag;
+  void operator()(void *root) const { dag->release(root); }
+};
+
+template <typename R>
+const DagBase *graph_of(const unique_ptr<R> &root) {
+  const DagDeleter *deleter = root.get_deleter().template target<DagDeleter>();
+  return deleter == nullptr ? nullptr : deleter->dag;
+}
+
 #define DAG_COMBINE(n, id) n##id
 #define _DAG_SHARED(line, ...)                                          \
   {                                                                     \
@@ -69,20 +235,105 @@ struct Dag {
 #define dag_shared DAG_SHARED_IMP(auto)
 #define DAG_SHARED dag_shared
 
-#define DAG_TEMPLATE_HELPER()                                                         \
-  template <typename NodeType, typename... Args>                                      \
-  NodeType &make_node(Args &&...args) {                                               \
-    return this->template do_make_node<NodeType>(std::forward<Args>(args)...);        \
-  }                                                                                   \
-  template <template <typename...> typename NodeTemplate, typename... Args>           \
-  auto &make_node_t(Args &&...args) {                                                 \
-    return this->template do_make_node_t<NodeTemplate>(std::forward<Args>(args)...);  \
-  }                                                                                   \
-  template <template <typename...> typename BPTemplate, typename F, typename... Args> \
-  auto &make_graph(F fn, Args &&...args) {                                            \
-    return this->template do_make_graph<BPTemplate>(fn, std::forward<Args>(args)...); \
+#define DAG_TEMPLATE_HELPER()                                                           \
+  template <typename NodeType, typename... Args>                                        \
+  NodeType &make_node(Args &&...args) {                                                 \
+    return this->template do_make_node<NodeType>(std::forward<Args>(args)...);          \
+  }                                                                                     \
+  template <template <typename...> typename NodeTemplate, typename... Args>             \
+  auto &make_node_t(Args &&...args) {                                                   \
+    return this->template do_make_node_t<NodeTemplate>(std::forward<Args>(args)...);    \
+  }                                                                                     \
+  template <template <typename...> typename BPTemplate, typename F, typename... Args>   \
+  auto &make_graph(F fn, Args &&...args) {                                              \
+    return this->template do_make_graph<BPTemplate>(fn, std::forward<Args>(args)...);   \
+  }                                                                                     \
+  template <typename NodeType, typename... Args>                                        \
+  auto &make_node_array(std::size_t n, Args &&...args) {                                \
+    return this->template do_make_node_array<NodeType>(n, std::forward<Args>(args)...); \
+  }
+
+// Passed first to the elements of make_node_array() that take it, e.g. to pick their shard.
+struct ArrayIndex {
+  std::size_t value;
+};
+
+// `n` nodes of one type built by make_node_array() in a single allocation, right after this
+// header. They are constructed in order, destroyed in reverse order, and owned by the dag as one
+// component; selecting NodeArray<T> selects the whole array. The header only holds the size, so
+// an array of relocatable nodes is itself relocatable.
+template <typename T>
+class NodeArray {
+ public:
+  explicit NodeArray(std::size_t size) : m_size(size) {}
+  NodeArray(const NodeArray &) = delete;
+  NodeArray &operator=(const NodeArray &) = delete;
+
+  T *data() const {
+    auto self = reinterpret_cast<std::byte *>(const_cast<NodeArray *>(this));
+    return reinterpret_cast<T *>(self + offset());
+  }
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  T *begin() const { return data(); }
+  T *end() const { return data() + m_size; }
+  T &operator[](std::size_t i) const { return data()[i]; }
+
+  template <typename U = T, typename = decltype(std::declval<U &>().dag_reset())>
+  void dag_reset() {
+    for (T &node : *this) {
+      node.dag_reset();
+    }
+  }
+
+  static constexpr std::size_t offset() {
+    return (sizeof(NodeArray) + alignof(T) - 1) / alignof(T) * alignof(T);
+  }
+  static constexpr std::size_t alignment() {
+    return alignof(T) > alignof(NodeArray) ? alignof(T) : alignof(NodeArray);
+  }
+  static std::size_t bytes(std::size_t n) { return offset() + n * sizeof(T); }
+
+  template <typename... Args>
+  static unique_ptr<NodeArray> make(std::pmr::memory_resource *memory, std::size_t n,
+                                    Args &...args) {
+    void *raw = memory->allocate(bytes(n), alignment());
+    T *data = reinterpret_cast<T *>(static_cast<std::byte *>(raw) + offset());
+    std::pmr::polymorphic_allocator<T> alloc{memory};
+    std::size_t built = 0;
+    try {
+      for (; built < n; ++built) {
+        if constexpr (std::is_constructible_v<T, ArrayIndex, Args &...>) {
+          alloc.construct(data + built, ArrayIndex{built}, args...);
+        } else {
+          alloc.construct(data + built, args...);
+        }
+      }
+    } catch (...) {
+      destroy(data, built);
+      memory->deallocate(raw, bytes(n), alignment());
+      throw;
+    }
+    auto array = new (raw) NodeArray(n);
+    return unique_ptr<NodeArray>(array, [memory](void *p) {  // NOSONAR
+      auto array = static_cast<NodeArray *>(p);
+      std::size_t n = array->m_size;
+      destroy(array->data(), n);
+      array->~NodeArray();
+      memory->deallocate(p, bytes(n), alignment());
+    });
+  }
+
+ private:
+  static void destroy(T *data, std::size_t n) {
+    while (n > 0) {
+      data[--n].~T();
+    }
   }
 
+  std::size_t m_size;
+};
+
 template <typename TypeToSelect>
 struct MutableDag : public Dag<TypeToSelect> {
   explicit MutableDag(std::pmr::memory_resource *memory)
@@ -96,21 +347,64 @@ struct MutableDag : public Dag<TypeToSelect> {
   MutableDag &operator=(MutableDag &&) = delete;
   const std::pmr::vector<TypeToSelect *> &selections() const override { return m_entryPoints; }
 
+  NodeIndex *enableIndex() {
+    this->m_index = make_unique_on_memory<NodeIndex>(memory(), memory());
+    return this->m_index.get();
+  }
+  NodeIndex *index() { return this->m_index.get(); }
+
+  std::pmr::memory_resource *memory() const { return m_entryPoints.get_allocator().resource(); }
+
+  void destroy() {
+    std::pmr::polymorphic_allocator<MutableDag> alloc{memory()};
+    alloc.destroy(this);
+    alloc.deallocate(this, 1);
+  }
+
+  void release(void *root) override {
+    if (m_recycle != nullptr) {
+      std::shared_ptr<void> recycler = m_recycler;  // recycle() may destroy this dag
+      m_recycle(recycler.get(), this, root);
+      return;
+    }
+    destroy();
+  }
+
+  // resets nodes in the order of their creation, so every node sees its dependencies reset first.
+  void reset() {
+    for (auto &[node, resetter] : m_resetters) {
+      resetter(node);
+    }
+  }
+
   std::pmr::vector<unique_ptr<void>> m_Components;
   std::pmr::vector<TypeToSelect *> m_entryPoints;
+  // only used when the dag is built for recycling.
+  std::pmr::vector<std::pair<void *, void (*)(void *)>> m_resetters{m_Components.get_allocator()};
+  bool m_resettable = true;
+  void (*m_recycle)(void *recycler, MutableDag *dag, void *root) = nullptr;
+  std::shared_ptr<void> m_recycler;
+  const void *m_shape = nullptr;
+  std::shared_ptr<const void> m_args;
 };
 
-template <typename T, typename... Args>
-unique_ptr<T> make_unique_on_memory(std::pmr::memory_resource *memory, Args &&...args) {
-  std::pmr::polymorphic_allocator<T> alloc{memory};
-  T *raw = alloc.allocate(1);
-  alloc.construct(raw, std::forward<Args>(args)...);
-  return unique_ptr<T>(raw, [alloc](void *p) mutable {  // NOSONAR
-    auto obj = static_cast<T *>(p);
-    alloc.destroy(obj);
-    alloc.deallocate(obj, 1);
-  });
-}
+// A node opts in to recycling by providing `void dag_reset()`, which puts it back into the state
+// it had right after construction.
+template <typename T, typename = void>
+struct has_dag_reset : std::false_type {};
+template <typename T>
+struct has_dag_reset<T, std::void_t<decltype(std::declval<T &>().dag_reset())>> : std::true_type {};
+
+template <typename T, typename = void>
+struct is_equality_comparable : std::false_type {};
+template <typename T>
+struct is_equality_comparable<
+    T, std::void_t<decltype(bool(std::declval<const T &>() == std::declval<const T &>()))>>
+    : std::true_type {};
+
+template <typename T>
+constexpr bool is_comparable_value_v =
+    std::is_copy_constructible_v<T> && is_equality_comparable<T>::value;
 
 struct DefaultCreater {
   template <typename T, typename... Args>
@@ -136,6 +430,196 @@ struct DefaultIntercepter {
   }
 };
 
+template <typename Stage, typename T, typename = void>
+struct intercepts : std::false_type {};
+template <typename Stage, typename T>
+struct intercepts<Stage, T,
+                  std::enable_if_t<std::is_same_v<
+                      dag::unique_ptr<T>, decltype(std::declval<Stage &>().after_create(
+                                              std::declval<std::pmr::memory_resource *>(),
+                                              std::declval<dag::unique_ptr<T>>()))>>>
+    : std::bool_constant<!std::is_same_v<Stage, DefaultIntercepter>> {};
+
+template <typename Stage, typename T, typename ArgsTuple, typename = void>
+struct creates : std::false_type {};
+template <typename Stage, typename T, typename... Args>
+struct creates<Stage, T, std::tuple<Args...>,
+               std::enable_if_t<std::is_same_v<
+                   dag::unique_ptr<T>, decltype(std::declval<Stage &>().template create<T>(
+                                           std::declval<std::pmr::memory_resource *>(),
+                                           std::declval<Args>()...))>>>
+    : std::bool_constant<!std::is_same_v<Stage, DefaultCreater>> {};
+
+// A Creater may also build the arrays of make_node_array() by providing
+// `unique_ptr<NodeArray<T>> create_array<T>(memory, n, args &...)`.
+template <typename Stage, typename T, typename ArgsTuple, typename = void>
+struct creates_arrays : std::false_type {};
+template <typename Stage, typename T, typename... Args>
+struct creates_arrays<Stage, T, std::tuple<Args...>,
+                      std::enable_if_t<std::is_same_v<
+                          dag::unique_ptr<NodeArray<T>>,
+                          decltype(std::declval<Stage &>().template create_array<T>(
+                              std::declval<std::pmr::memory_resource *>(), std::size_t{},
+                              std::declval<Args &>()...))>>> : std::true_type {};
+
+// Composes several intercepters or creaters into one, e.g. DagFactory<BP, Select<T>,
+// Chain<Profiler, Validator>>. after_create() runs every stage that handles the node type, in
+// order. create() is served by the first stage able to create the node type, DefaultCreater
+// otherwise. Stages that do not apply to a type, and default stages, are dropped at compile time.
+template <typename... Stages>
+struct Chain {
+  Chain() = default;
+  explicit Chain(Stages... stages) : m_stages(std::move(stages)...) {}
+
+  template <typename Stage>
+  Stage &get() {
+    return std::get<Stage>(m_stages);
+  }
+  template <std::size_t I>
+  auto &get() {
+    return std::get<I>(m_stages);
+  }
+
+  template <typename T>
+  dag::unique_ptr<T> after_create(std::pmr::memory_resource *memory, dag::unique_ptr<T> v) {
+    return afterCreate<0>(memory, std::move(v));
+  }
+
+  template <typename T, typename... Args>
+  dag::unique_ptr<T> create(std::pmr::memory_resource *memory, Args &&...args) {
+    return createWith<0, T>(memory, std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  dag::unique_ptr<NodeArray<T>> create_array(std::pmr::memory_resource *memory, std::size_t n,
+                                             Args &...args) {
+    return createArrayWith<0, T>(memory, n, args...);
+  }
+
+ private:
+  template <std::size_t I>
+  using StageAt = std::tuple_element_t<I, std::tuple<Stages...>>;
+
+  template <std::size_t I, typename T>
+  dag::unique_ptr<T> afterCreate(std::pmr::memory_resource *memory, dag::unique_ptr<T> v) {
+    if constexpr (I == sizeof...(Stages)) {
+      return v;
+    } else {
+      if constexpr (intercepts<StageAt<I>, T>::value) {
+        v = std::get<I>(m_stages).after_create(memory, std::move(v));
+      }
+      return afterCreate<I + 1>(memory, std::move(v));
+    }
+  }
+
+  template <std::size_t I, typename T, typename... Args>
+  dag::unique_ptr<T> createWith(std::pmr::memory_resource *memory, Args &&...args) {
+    if constexpr (I == sizeof...(Stages)) {
+      return DefaultCreater::instance().create<T>(memory, std::forward<Args>(args)...);
+    } else if constexpr (creates<StageAt<I>, T, std::tuple<Args &&...>>::value) {
+      return std::get<I>(m_stages).template create<T>(memory, std::forward<Args>(args)...);
+    } else {
+      return createWith<I + 1, T>(memory, std::forward<Args>(args)...);
+    }
+  }
+
+  template <std::size_t I, typename T, typename... Args>
+  dag::unique_ptr<NodeArray<T>> createArrayWith(std::pmr::memory_resource *memory, std::size_t n,
+                                                Args &...args) {
+    if constexpr (I == sizeof...(Stages)) {
+      return NodeArray<T>::make(memory, n, args...);
+    } else if constexpr (creates_arrays<StageAt<I>, T, std::tuple<Args...>>::value) {
+      return std::get<I>(m_stages).template create_array<T>(memory, n, args...);
+    } else {
+      return createArrayWith<I + 1, T>(memory, n, args...);
+    }
+  }
+
+  std::tuple<Stages...> m_stages;
+};
+
+// Keeps one instance of T per calling thread, so that a DagFactory shared by several threads can
+// use stateful extensions and memory resources without any of them writing shared state while
+// create() runs. Used as an Intercepter or a Creater it forwards to the calling thread's instance;
+// used as the factory's memory it hands every thread a resource of its own. Instances live until
+// the PerThread is destroyed, and for_each() visits them to merge their state once the threads
+// are done.
+template <typename T>
+class PerThread {
+ public:
+  PerThread() : m_make([] { return std::make_unique<Slot>(); }) {}
+  template <typename... Args>
+  explicit PerThread(const Args &...args)
+      : m_make([args...] { return std::make_unique<Slot>(args...); }) {}
+  PerThread(const PerThread &) = delete;
+  PerThread &operator=(const PerThread &) = delete;
+
+  T &local() {
+    thread_local Cached last;
+    if (last.id == m_id) {
+      return *last.value;
+    }
+    thread_local std::unordered_map<std::uint64_t, T *> cache;
+    auto found = cache.find(m_id);
+    if (found == cache.end()) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_slots.push_back(m_make());
+      found = cache.emplace(m_id, &m_slots.back()->value).first;
+    }
+    last = {m_id, found->second};
+    return *found->second;
+  }
+
+  template <typename F>
+  void for_each(F fn) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &slot : m_slots) {
+      fn(slot->value);
+    }
+  }
+
+  // Like create_array(), these only exist for the node types T handles, so that Chain<> can tell.
+  template <typename NodeType, typename U = T>
+  auto after_create(std::pmr::memory_resource *memory, dag::unique_ptr<NodeType> v)
+      -> decltype(std::declval<U &>().after_create(memory, std::move(v))) {
+    return local().after_create(memory, std::move(v));
+  }
+
+  template <typename NodeType, typename... Args>
+  auto create(std::pmr::memory_resource *memory, Args &&...args)
+      -> decltype(std::declval<T &>().template create<NodeType>(memory,
+                                                                 std::forward<Args>(args)...)) {
+    return local().template create<NodeType>(memory, std::forward<Args>(args)...);
+  }
+
+  template <typename NodeType, typename... Args>
+  auto create_array(std::pmr::memory_resource *memory, std::size_t n, Args &...args)
+      -> decltype(std::declval<T &>().template create_array<NodeType>(memory, n, args...)) {
+    return local().template create_array<NodeType>(memory, n, args...);
+  }
+
+ private:
+  // Each instance gets its own cache line so that threads never write to a shared one.
+  struct alignas(64) Slot {
+    template <typename... Args>
+    explicit Slot(Args &&...args) : value(std::forward<Args>(args)...) {}
+    T value;
+  };
+  struct Cached {
+    std::uint64_t id = 0;
+    T *value = nullptr;
+  };
+  static std::uint64_t nextId() {
+    static std::atomic<std::uint64_t> next{0};
+    return ++next;
+  }
+
+  const std::uint64_t m_id = nextId();
+  std::function<std::unique_ptr<Slot>()> m_make;
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<Slot>> m_slots;
+};
+
 template <typename T>
 struct Select {
   using TypeToSelect = T;
@@ -148,6 +632,205 @@ struct DagExtensions {
   using Intercepter = Intercepter_t;
 };
 
+struct Redundancy {
+  std::string_view type;
+  std::size_t duplicates = 0;  // nodes equal to one built earlier in the same dag
+  std::size_t bytes = 0;       // memory held by the duplicates
+};
+
+// What DagFactory::detect_redundancy() found, accumulated over every create() since.
+class RedundancyReport {
+ public:
+  std::vector<Redundancy> entries() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries;
+  }
+  std::size_t bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::size_t total = 0;
+    for (auto &entry : m_entries) {
+      total += entry.bytes;
+    }
+    return total;
+  }
+  void merge(const std::vector<Redundancy> &found) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &redundancy : found) {
+      auto entry = m_entries.begin();
+      while (entry != m_entries.end() && entry->type != redundancy.type) {
+        ++entry;
+      }
+      if (entry == m_entries.end()) {
+        entry = m_entries.insert(entry, {redundancy.type});
+      }
+      entry->duplicates += redundancy.duplicates;
+      entry->bytes += redundancy.bytes;
+    }
+  }
+
+ private:
+  mutable std::mutex m_mutex;
+  std::vector<Redundancy> m_entries;
+};
+
+// Arguments of make_node() that are nodes of the same dag are compared by identity, which is how
+// dependencies are passed; the others are compared by value. An lvalue that is not a node keeps
+// its address out of the key, so a local variable reused across calls is compared by its value.
+template <typename Arg, typename T = std::decay_t<Arg>>
+using redundancy_key_t =
+    std::conditional_t<!std::is_lvalue_reference_v<Arg>, T,
+                       std::conditional_t<is_comparable_value_v<T>,
+                                          std::pair<const void *, std::optional<T>>, const void *>>;
+
+template <typename... Args>
+constexpr bool is_redundancy_trackable_v =
+    ((std::is_lvalue_reference_v<Args> || is_comparable_value_v<std::decay_t<Args>>) && ...);
+
+// Finds nodes of one dag that have the same type as an earlier node and were made from the same
+// arguments, i.e. nodes that a dag_shared factory method would have built only once.
+class RedundancyDetector {
+ public:
+  explicit RedundancyDetector(bool coalesce) : m_coalesce(coalesce) {}
+
+  bool coalesce() const { return m_coalesce; }
+
+  void addNode(const void *node) { m_nodes.insert(node); }
+
+  // clears `tracked` when the argument can be compared neither by identity nor by value.
+  template <typename Arg>
+  redundancy_key_t<Arg> keyOf(std::remove_reference_t<Arg> &arg, bool &tracked) const {
+    if constexpr (!std::is_lvalue_reference_v<Arg>) {
+      return arg;
+    } else {
+      using Key = redundancy_key_t<Arg>;
+      bool node = m_nodes.count(&arg) != 0;
+      if constexpr (is_comparable_value_v<std::decay_t<Arg>>) {
+        return node ? Key{&arg, std::nullopt} : Key{nullptr, arg};
+      } else {
+        tracked = tracked && node;
+        return &arg;
+      }
+    }
+  }
+
+  // returns the node built earlier from the same key, and counts the new one as a duplicate.
+  template <typename NodeType, typename Key>
+  NodeType *find(const Key &key) {
+    auto [begin, end] = m_seen.equal_range(hashOf(key));
+    for (auto itr = begin; itr != end; ++itr) {
+      const Seen &seen = itr->second;
+      if (seen.shape == type_key<std::pair<NodeType, Key>>() &&
+          *static_cast<const Key *>(seen.key.get()) == key) {
+        auto &found = m_found[type_key<NodeType>()];
+        found.type = type_name<NodeType>();
+        found.duplicates += 1;
+        found.bytes += sizeof(NodeType);
+        return static_cast<NodeType *>(seen.node);
+      }
+    }
+    return nullptr;
+  }
+
+  template <typename NodeType, typename Key>
+  void remember(NodeType *node, Key key) {
+    std::size_t hash = hashOf(key);
+    m_seen.emplace(hash, Seen{type_key<std::pair<NodeType, Key>>(), node,
+                              std::make_shared<const Key>(std::move(key))});
+  }
+
+  std::vector<Redundancy> found() const {
+    std::vector<Redundancy> result;
+    for (auto &[type, redundancy] : m_found) {
+      result.push_back(redundancy);
+    }
+    return result;
+  }
+
+ private:
+  struct Seen {
+    const void *shape;
+    void *node;
+    std::shared_ptr<const void> key;
+  };
+
+  template <typename... T>
+  static std::size_t hashOf(const std::tuple<T...> &key) {
+    std::size_t hash = sizeof...(T);
+    std::apply(
+        [&hash](const auto &...element) {
+          ((hash = hash * 31 + hashElement(element)), ...);
+        },
+        key);
+    return hash;
+  }
+
+  template <typename T>
+  static std::size_t hashElement(const std::pair<const void *, std::optional<T>> &element) {
+    return std::hash<const void *>()(element.first) * 31 + hashElement(element.second);
+  }
+
+  template <typename T>
+  static std::size_t hashElement(const T &element) {
+    if constexpr (std::is_default_constructible_v<std::hash<T>>) {
+      return std::hash<T>()(element);
+    } else {
+      return 0;
+    }
+  }
+
+  bool m_coalesce;
+  std::unordered_multimap<std::size_t, Seen> m_seen;
+  std::unordered_map<const void *, Redundancy> m_found;
+  std::unordered_set<const void *> m_nodes;
+};
+
+// Stops a create() in progress, typically from another thread.
+class CancellationToken {
+ public:
+  void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+  bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<bool> m_cancelled{false};
+};
+
+struct NodeTiming {
+  std::string_view type;
+  std::chrono::steady_clock::duration elapsed;
+};
+
+// Bounds a DagFactory::create(). The limits are checked before each node and each sub-graph is
+// made, so a single slow constructor still runs to completion.
+struct BuildLimits {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  const CancellationToken *token = nullptr;
+  // when set, receives the time spent creating each node, in creation order.
+  std::vector<NodeTiming> *timings = nullptr;
+};
+
+enum class BuildStatus { Built, TimedOut, Cancelled };
+
+template <typename T>
+struct BuildResult {
+  BuildStatus status;
+  T graph;  // empty unless the graph was built
+  explicit operator bool() const { return status == BuildStatus::Built; }
+};
+
+// Thrown through the Blueprint to unwind a create() that ran out of time or was cancelled.
+class BuildInterrupted : public std::exception {
+ public:
+  explicit BuildInterrupted(BuildStatus status) : m_status(status) {}
+  BuildStatus status() const { return m_status; }
+  const char *what() const noexcept override {
+    return m_status == BuildStatus::Cancelled ? "dag construction cancelled"
+                                              : "dag construction timed out";
+  }
+
+ private:
+  BuildStatus m_status;
+};
+
 template <typename Extentions>
 struct DagContext {
   using TypeToSelect = typename Extentions::TypeToSelect;
@@ -157,9 +840,44 @@ struct DagContext {
       : m_Dag(dag), m_Creater(creater), m_Intercepter(intercepter) {}
   void saveEntrypoint(TypeToSelect *o) { m_Dag.m_entryPoints.push_back(o); }
   void saveEntrypoint(...) {}  // NOSONAR
+  template <typename NodeType>
+  void saveResetter(NodeType *o) {
+    if constexpr (has_dag_reset<NodeType>::value) {
+      m_Dag.m_resetters.emplace_back(o, [](void *p) { static_cast<NodeType *>(p)->dag_reset(); });
+    } else {
+      m_Dag.m_resettable = false;
+    }
+  }
   MutableDag<TypeToSelect> &m_Dag;
   Creater &m_Creater;
   Intercepter &m_Intercepter;
+  bool m_recycling = false;
+  RedundancyDetector *m_redundancy = nullptr;
+  const BuildLimits *m_limits = nullptr;
+
+  void checkLimits() const {
+    if (m_limits == nullptr) {
+      return;
+    }
+    if (m_limits->token != nullptr && m_limits->token->cancelled()) {
+      throw BuildInterrupted(BuildStatus::Cancelled);
+    }
+    if (std::chrono::steady_clock::now() > m_limits->deadline) {
+      throw BuildInterrupted(BuildStatus::TimedOut);
+    }
+  }
+
+  // returns make(), recording how long it took as the creation of a NodeType when asked to.
+  template <typename NodeType, typename F>
+  auto timed(F make) const {
+    if (m_limits == nullptr || m_limits->timings == nullptr) {
+      return make();
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto node = make();
+    m_limits->timings->push_back({type_name<NodeType>(), std::chrono::steady_clock::now() - start});
+    return node;
+  }
 };
 struct Nothing {};
 
@@ -171,15 +889,32 @@ struct Blueprint {
   using TypeToSelect = typename Extensions::TypeToSelect;
   template <typename NodeType, typename... Args>
   NodeType &do_make_node(Args &&...args) {
+    return do_make_node<NodeType>(Tag{}, std::forward<Args>(args)...);
+  }
+
+  template <typename NodeType, typename... Args>
+  NodeType &do_make_node(Tag tag, Args &&...args) {
     auto context = static_cast<DagContext<Extensions> *>(_hidden_context);
-    std::pmr::memory_resource *memory = context->m_Dag.m_entryPoints.get_allocator().resource();
-    unique_ptr<NodeType> o =
-        context->m_Creater.template create<NodeType>(memory, std::forward<Args>(args)...);
-    o = context->m_Intercepter.after_create(memory, std::move(o));
-    NodeType *ptr = o.get();
-    context->m_Dag.m_Components.emplace_back(std::move(o));
-    context->saveEntrypoint(ptr);
-    return *ptr;
+    if constexpr (is_redundancy_trackable_v<Args...>) {
+      if (RedundancyDetector *detector = context->m_redundancy) {
+        bool tracked = true;
+        // nodes tagged differently are meant to be told apart, so the tag is part of the key.
+        std::tuple<std::string, redundancy_key_t<Args>...> key{
+            std::string(tag.name), detector->keyOf<Args>(args, tracked)...};
+        if (tracked) {
+          NodeType *same = detector->find<NodeType>(key);
+          if (same != nullptr && detector->coalesce()) {
+            return *same;
+          }
+          NodeType &node = makeNode<NodeType>(context, tag, std::forward<Args>(args)...);
+          if (same == nullptr) {
+            detector->remember(&node, std::move(key));
+          }
+          return node;
+        }
+      }
+    }
+    return makeNode<NodeType>(context, tag, std::forward<Args>(args)...);
   }
 
   template <template <typename...> typename NodeTemplate, typename... Args>
@@ -188,19 +923,95 @@ struct Blueprint {
     return do_make_node<NodeType>(std::forward<Args>(args)...);
   }
 
+  // Every element is constructed from the same `args`, preceded by its ArrayIndex when it takes
+  // one, by the Creater's create_array() when it has one. The Intercepter is not involved, since
+  // it deals with one node at a time.
+  template <typename NodeType, typename... Args>
+  NodeArray<NodeType> &do_make_node_array(std::size_t n, Args &&...args) {
+    auto context = static_cast<DagContext<Extensions> *>(_hidden_context);
+    context->checkLimits();
+    std::pmr::memory_resource *memory = context->m_Dag.memory();
+    auto o = context->template timed<NodeArray<NodeType>>([&] {
+      if constexpr (creates_arrays<typename Extensions::Creater, NodeType,
+                                   std::tuple<Args...>>::value) {
+        return context->m_Creater.template create_array<NodeType>(memory, n, args...);
+      } else {
+        return NodeArray<NodeType>::make(memory, n, args...);
+      }
+    });
+    NodeArray<NodeType> *ptr = o.get();
+    context->m_Dag.m_Components.emplace_back(std::move(o));
+    context->saveEntrypoint(ptr);
+    if (context->m_recycling) {
+      context->saveResetter(ptr);
+    }
+    if (NodeIndex *index = context->m_Dag.index()) {
+      index->add(ptr, {});
+    }
+    if (context->m_redundancy != nullptr) {
+      context->m_redundancy->addNode(ptr);
+    }
+    return *ptr;
+  }
+
   template <template <typename> typename BP_Template, typename BP = BP_Template<Extensions>,
             typename F, typename RR = typename std::invoke_result<F, BP *>::type,
             typename R = typename std::remove_reference<RR>::type, typename... Args>
   R &do_make_graph(F initializer, Args &&...args) {
     static_assert(std::is_reference_v<RR>, "initializer must return a refernce of a dag node.");
+    static_cast<DagContext<Extensions> *>(_hidden_context)->checkLimits();
     BP bluepoint{std::forward<Args>(args)...};
     bluepoint._hidden_context = _hidden_context;
     return initializer(&bluepoint);
   }
 
   DAG_TEMPLATE_HELPER()
+
+ private:
+  template <typename NodeType, typename... Args>
+  NodeType &makeNode(DagContext<Extensions> *context, Tag tag, Args &&...args) {
+    context->checkLimits();
+    std::pmr::memory_resource *memory = context->m_Dag.m_entryPoints.get_allocator().resource();
+    unique_ptr<NodeType> o = context->template timed<NodeType>([&] {
+      unique_ptr<NodeType> created =
+          context->m_Creater.template create<NodeType>(memory, std::forward<Args>(args)...);
+      return context->m_Intercepter.after_create(memory, std::move(created));
+    });
+    NodeType *ptr = o.get();
+    context->m_Dag.m_Components.emplace_back(std::move(o));
+    context->saveEntrypoint(ptr);
+    if (context->m_recycling) {
+      context->saveResetter(ptr);
+    }
+    if (NodeIndex *index = context->m_Dag.index()) {
+      index->add(ptr, tag.name);
+    }
+    if (context->m_redundancy != nullptr) {
+      context->m_redundancy->addNode(ptr);
+    }
+    return *ptr;
+  }
 };
 
+// create() may be called concurrently on a shared factory as long as the Intercepter and the
+// Creater are stateless or otherwise thread-safe. Wrap stateful ones in PerThread<>, and pass a
+// PerThread<> of memory resources to give every thread its own arena. Such a resource must accept
+// deallocations from other threads if graphs are released on a thread other than their creator.
+//
+// With enable_recycling(), a released graph whose nodes all implement dag_reset() is reset in
+// place and kept by the factory. The next create() with the same initializer and equal arguments
+// returns it instead of building a new one; arguments passed as lvalues must also be the same
+// objects, since the Blueprint may keep references to them. Graphs with other nodes are destroyed
+// and rebuilt as usual. So are the graphs of initializers that are neither stateless nor equality
+// comparable, such as lambdas with captures, and of arguments that are not copyable and equality
+// comparable. A graph released after its factory is destroyed is destroyed as well.
+//
+// Arrays made by make_node_array() are built by the Creater's create_array() if it provides one,
+// as ImageCreater and Chain do. Creaters without it, the Intercepter and redundancy detection do
+// not see arrays or their elements.
+//
+// create(limits, ...) stops building once the deadline passes or the token is cancelled. The nodes
+// built so far are destroyed in reverse order, and the result carries why the graph is missing.
 template <template <typename> class BP_Template, typename Selecter = Select<Nothing>,
           typename Intercepter = DefaultIntercepter, typename Creater = DefaultCreater>
 struct DagFactory {
@@ -210,55 +1021,227 @@ struct DagFactory {
                       Intercepter &intercepter = DefaultIntercepter::instance(),
                       Creater &creater = DefaultCreater::instance())
       : m_memory(memory), m_intercepter(intercepter), m_creater(creater) {}
+  template <typename Resource,
+            typename = std::enable_if_t<std::is_base_of_v<std::pmr::memory_resource, Resource>>>
+  explicit DagFactory(PerThread<Resource> &memory,
+                      Intercepter &intercepter = DefaultIntercepter::instance(),
+                      Creater &creater = DefaultCreater::instance())
+      : m_memory(nullptr),
+        m_localMemory([&memory]() -> std::pmr::memory_resource * { return &memory.local(); }),
+        m_intercepter(intercepter),
+        m_creater(creater) {}
   DagFactory(const DagFactory<BP_Template, Selecter, Intercepter, Creater> &) = delete;
 
   template <typename F, typename RR = typename std::invoke_result<F, BP *>::type,
             typename R = typename std::remove_reference<RR>::type, typename... Args>
   auto create(F initializer, Args &&...args) {
-    return doCreate<BP, F, RR, R>(m_memory, initializer, std::forward<Args>(args)...);
+    std::pmr::memory_resource *memory = m_localMemory ? m_localMemory() : m_memory;
+    return doCreate<BP, F, RR, R>(memory, nullptr, initializer, std::forward<Args>(args)...);
+  }
+
+  template <typename F, typename RR = typename std::invoke_result<F, BP *>::type,
+            typename R = typename std::remove_reference<RR>::type, typename... Args>
+  auto create(const BuildLimits &limits, F initializer, Args &&...args) {
+    std::pmr::memory_resource *memory = m_localMemory ? m_localMemory() : m_memory;
+    using Result = decltype(doCreate<BP, F, RR, R>(memory, &limits, initializer,
+                                                    std::forward<Args>(args)...));
+    try {
+      Result graph =
+          doCreate<BP, F, RR, R>(memory, &limits, initializer, std::forward<Args>(args)...);
+      return BuildResult<Result>{BuildStatus::Built, std::move(graph)};
+    } catch (const BuildInterrupted &interrupted) {
+      return BuildResult<Result>{interrupted.status(), Result()};
+    }
+  }
+
+  ~DagFactory() {
+    std::vector<Recycled> recycled;
+    {
+      std::lock_guard<std::mutex> lock(m_pool->mutex);
+      m_pool->open = false;
+      recycled.swap(m_pool->graphs);
+    }
+    for (auto &graph : recycled) {
+      graph.dag->destroy();
+    }
+  }
+
+  void enable_recycling() { m_recycling = true; }
+
+  // Indexes the nodes of every dag this factory builds, see DagBase::find() and DagBase::all().
+  void enable_index() { m_indexing = true; }
+
+  // Reports nodes built more than once from the same arguments within a dag, typically by a
+  // factory method missing dag_shared. With `coalesce`, the duplicates are not built and the
+  // node built first is used in their place.
+  void detect_redundancy(RedundancyReport &report, bool coalesce = false) {
+    m_redundancy = &report;
+    m_coalesce = coalesce;
   }
 
  private:
-  template <typename BP, typename F, typename RR, typename R, typename... Args>
-  std::pair<unique_ptr<R>, const std::pmr::vector<typename BP::TypeToSelect *> *> createCommon(
-      std::pmr::memory_resource *memory, F initializer, Args &&...args) {
-    static_assert(std::is_reference_v<RR>, "initializer must return a refernce of a dag node.");
-    std::pmr::polymorphic_allocator<MutableDag<typename BP::TypeToSelect>> alloc{memory};
+  using Graph = MutableDag<typename Extensions::TypeToSelect>;
+
+  struct Recycled {
+    Graph *dag;
+    void *root;
+  };
+
+  // Shared with the graphs built for recycling, so that one released after the factory is gone
+  // finds the pool closed instead of a destroyed factory.
+  struct RecyclePool {
+    std::mutex mutex;
+    bool open = true;
+    std::vector<Recycled> graphs;
+  };
 
-    unique_ptr<MutableDag<typename BP::TypeToSelect>> dag =
-        make_unique_on_memory<MutableDag<typename BP::TypeToSelect>>(memory, memory);
+  template <typename... T>
+  static const void *shapeOf() {
+    static const char shape = 0;
+    return &shape;
+  }
+
+  // Stateless initializers, such as lambdas without captures, are told apart by their type alone.
+  template <typename F>
+  using initializer_key_t = std::conditional_t<std::is_empty_v<F>, std::tuple<>, F>;
+
+  template <typename Arg>
+  using argument_key_t =
+      std::conditional_t<std::is_lvalue_reference_v<Arg>,
+                         std::pair<const void *, std::decay_t<Arg>>, std::decay_t<Arg>>;
+
+  template <typename F>
+  static initializer_key_t<F> initializerKey(const F &initializer) {
+    if constexpr (std::is_empty_v<F>) {
+      return {};
+    } else {
+      return initializer;
+    }
+  }
+
+  template <typename Arg>
+  static argument_key_t<Arg> argumentKey(const std::remove_reference_t<Arg> &arg) {
+    if constexpr (std::is_lvalue_reference_v<Arg>) {
+      return {&arg, arg};
+    } else {
+      return arg;
+    }
+  }
+
+  template <typename BP, typename R, typename F, typename... Args>
+  std::pair<R *, unique_ptr<Graph>> build(std::pmr::memory_resource *memory,
+                                          const BuildLimits *limits, bool recycling,
+                                          F initializer, Args &&...args) {
+    unique_ptr<Graph> dag = make_unique_on_memory<Graph>(memory, memory);
+    if (m_indexing) {
+      dag->enableIndex();
+    }
     DagContext<Extensions> factory{*dag, m_creater, m_intercepter};
+    factory.m_recycling = recycling;
+    factory.m_limits = limits;
+    std::optional<RedundancyDetector> detector;
+    if (m_redundancy != nullptr) {
+      factory.m_redundancy = &detector.emplace(m_coalesce);
+    }
     BP bluepoint{std::forward<Args>(args)...};
     bluepoint._hidden_context = &factory;
     R &result = initializer(&bluepoint);
+    if (detector) {
+      m_redundancy->merge(detector->found());
+    }
+    return {&result, std::move(dag)};
+  }
+
+  template <typename BP, typename F, typename RR, typename R, typename... Args>
+  std::pair<unique_ptr<R>, const std::pmr::vector<typename BP::TypeToSelect *> *> createCommon(
+      std::pmr::memory_resource *memory, const BuildLimits *limits, F initializer,
+      Args &&...args) {
+    static_assert(std::is_reference_v<RR>, "initializer must return a refernce of a dag node.");
+    if constexpr (is_comparable_value_v<initializer_key_t<F>> &&
+                  (is_comparable_value_v<std::decay_t<Args>> && ...)) {
+      if (m_recycling) {
+        return createRecycled<BP, R>(memory, limits, initializer, std::forward<Args>(args)...);
+      }
+    }
+    auto [result, dag] =
+        build<BP, R>(memory, limits, false, initializer, std::forward<Args>(args)...);
+
+    Graph *dag_address = dag.release();
+    return {unique_ptr<R>(result, DagDeleter{dag_address}), &dag_address->selections()};
+  }
 
-    MutableDag<typename BP::TypeToSelect> *dag_address = dag.release();
-    auto dag_deleter = dag.get_deleter();
-    return {unique_ptr<R>(&result,
-                          [dag_address, alloc](void *) mutable {  // NOSONAR
-                            alloc.destroy(dag_address);
-                            alloc.deallocate(dag_address, 1);
-                          }),
-            &dag_address->selections()};
+  template <typename BP, typename R, typename F, typename... Args>
+  std::pair<unique_ptr<R>, const std::pmr::vector<typename BP::TypeToSelect *> *> createRecycled(
+      std::pmr::memory_resource *memory, const BuildLimits *limits, F initializer,
+      Args &&...args) {
+    using Key = std::tuple<initializer_key_t<F>, argument_key_t<Args>...>;
+    const void *shape = shapeOf<F, Key>();
+    const Key key{initializerKey(initializer), argumentKey<Args>(args)...};
+
+    R *result = nullptr;
+    Graph *dag_address = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(m_pool->mutex);
+      for (auto itr = m_pool->graphs.begin(); itr != m_pool->graphs.end(); ++itr) {
+        if (itr->dag->m_shape == shape &&
+            *static_cast<const Key *>(itr->dag->m_args.get()) == key) {
+          result = static_cast<R *>(itr->root);
+          dag_address = itr->dag;
+          m_pool->graphs.erase(itr);
+          break;
+        }
+      }
+    }
+    if (dag_address == nullptr) {
+      auto built = build<BP, R>(memory, limits, true, initializer, std::forward<Args>(args)...);
+      result = built.first;
+      dag_address = built.second.release();
+      dag_address->m_shape = shape;
+      dag_address->m_args = std::make_shared<const Key>(key);
+      dag_address->m_recycle = &DagFactory::recycle;
+      dag_address->m_recycler = m_pool;
+    }
+    return {unique_ptr<R>(result, DagDeleter{dag_address}), &dag_address->selections()};
+  }
+
+  static void recycle(void *recycler, Graph *dag, void *root) {
+    if (dag->m_resettable) {
+      dag->reset();
+      auto pool = static_cast<RecyclePool *>(recycler);
+      std::lock_guard<std::mutex> lock(pool->mutex);
+      if (pool->open) {
+        pool->graphs.push_back({dag, root});
+        return;
+      }
+    }
+    dag->destroy();
   }
 
   template <typename BP, typename F, typename RR, typename R,
             typename = std::enable_if_t<!std::is_same_v<Nothing, typename BP::TypeToSelect>>,
             typename... Args>
   std::pair<unique_ptr<R>, const std::pmr::vector<typename BP::TypeToSelect *> *> doCreate(
-      std::pmr::memory_resource *memory, F initializer, Args &&...args) {
-    return createCommon<BP, F, RR, R>(memory, initializer, std::forward<Args>(args)...);
+      std::pmr::memory_resource *memory, const BuildLimits *limits, F initializer,
+      Args &&...args) {
+    return createCommon<BP, F, RR, R>(memory, limits, initializer, std::forward<Args>(args)...);
   }
 
   template <typename BP, typename F, typename RR, typename R,
             typename = std::enable_if_t<std::is_same_v<Nothing, typename BP::TypeToSelect>>,
             typename... Args>
-  unique_ptr<R> doCreate(std::pmr::memory_resource *memory, F initializer, Args &&...args) {
-    auto dag = createCommon<BP, F, RR, R>(memory, initializer, std::forward<Args>(args)...);
+  unique_ptr<R> doCreate(std::pmr::memory_resource *memory, const BuildLimits *limits,
+                         F initializer, Args &&...args) {
+    auto dag = createCommon<BP, F, RR, R>(memory, limits, initializer, std::forward<Args>(args)...);
     return std::move(dag.first);
   }
   std::pmr::memory_resource *m_memory;
+  std::function<std::pmr::memory_resource *()> m_localMemory;
   Intercepter &m_intercepter;
   Creater &m_creater;
+  bool m_recycling = false;
+  bool m_indexing = false;
+  RedundancyReport *m_redundancy = nullptr;
+  bool m_coalesce = false;
+  std::shared_ptr<RecyclePool> m_pool = std::make_shared<RecyclePool>();
 };
 }  // namespace dag
\ No newline at end of file
@@ -0,0 +1,350 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2024, Darklen84
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dag/arena_resource.h"
+#include "dag/dag_factory.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A dag image is a snapshot of a dag built in an ArenaResource, written to a file and mapped back
+// copy-on-write by a later run without running any constructor. It only works for graphs whose
+// nodes are all relocatable: they opt in with `static constexpr bool dag_relocatable = true;`,
+// need no destructor, and refer to other nodes through RelPtr<> rather than references or
+// pointers.
+namespace dag {
+
+// A pointer stored as the distance from itself, so it stays valid when the memory holding both
+// ends is mapped at another address.
+template <typename T>
+class RelPtr {
+ public:
+  RelPtr() = default;
+  explicit RelPtr(T &target) { set(&target); }
+  RelPtr(const RelPtr &other) { set(other.get()); }
+  RelPtr &operator=(const RelPtr &other) {
+    set(other.get());
+    return *this;
+  }
+
+  T *get() const {
+    if (m_offset == 0) {
+      return nullptr;
+    }
+    auto self = reinterpret_cast<std::intptr_t>(this);
+    return reinterpret_cast<T *>(self + m_offset);
+  }
+  T &operator*() const { return *get(); }
+  T *operator->() const { return get(); }
+
+ private:
+  void set(T *target) {
+    m_offset = target == nullptr ? 0
+                                 : reinterpret_cast<std::intptr_t>(target) -
+                                       reinterpret_cast<std::intptr_t>(this);
+  }
+  std::intptr_t m_offset = 0;
+};
+
+template <typename T, typename = void>
+struct is_relocatable : std::is_arithmetic<T> {};
+template <typename T>
+struct is_relocatable<T, std::enable_if_t<T::dag_relocatable>>
+    : std::is_trivially_destructible<T> {};
+template <typename T>
+struct is_relocatable<NodeArray<T>> : is_relocatable<T> {};
+
+// Creater for graphs meant to be saved as images; it refuses nodes that are not relocatable.
+struct ImageCreater {
+  template <typename T, typename... Args>
+  dag::unique_ptr<T> create(std::pmr::memory_resource *memory, Args &&...args) const {
+    static_assert(is_relocatable<T>::value,
+                  "nodes of a dag image must set dag_relocatable and be trivially destructible.");
+    return dag::make_unique_on_memory<T>(memory, std::forward<Args>(args)...);
+  }
+  template <typename T, typename... Args>
+  dag::unique_ptr<NodeArray<T>> create_array(std::pmr::memory_resource *memory, std::size_t n,
+                                             Args &...args) const {
+    static_assert(is_relocatable<T>::value,
+                  "nodes of a dag image must set dag_relocatable and be trivially destructible.");
+    return NodeArray<T>::make(memory, n, args...);
+  }
+  static ImageCreater &instance() {
+    static ImageCreater instance;
+    return instance;
+  }
+};
+
+// Whether a Creater builds every node through ImageCreater. A Chain<> qualifies when its first
+// stage does, since ImageCreater accepts every node type and later stages are never asked.
+template <typename Creater>
+struct is_image_creater : std::is_same<Creater, ImageCreater> {};
+template <typename T>
+struct is_image_creater<PerThread<T>> : is_image_creater<T> {};
+template <typename First, typename... Rest>
+struct is_image_creater<Chain<First, Rest...>> : is_image_creater<First> {};
+
+struct ImageHeader {
+  static constexpr std::uint64_t kMagic = 0x31474d4947414400;  // "\0DAGIMG1"
+  static constexpr std::uint64_t kPayload = 4096;  // keeps the payload page aligned once mapped
+
+  std::uint64_t magic = kMagic;
+  std::uint64_t hash = 0;
+  std::uint64_t size = 0;
+  std::uint64_t root = 0;
+  std::uint64_t selections = 0;
+  // followed by `selections` offsets, then the payload at kPayload.
+};
+
+inline std::uint64_t image_hash(std::string_view text, std::uint64_t hash = 14695981039346656037u) {
+  for (char c : text) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211u;
+  }
+  return hash;
+}
+
+// Identifies the images of a Blueprint. The types involved are covered, their code is not: bump
+// `version` whenever the Blueprint or the layout of its nodes change. image_hash_argument() adds
+// the arguments the Blueprint is built from.
+template <typename BP, typename R, typename TypeToSelect>
+std::uint64_t image_hash(std::uint64_t version) {
+  std::uint64_t hash = image_hash(type_name<BP>());
+  hash = image_hash(type_name<R>(), hash);
+  hash = image_hash(type_name<TypeToSelect>(), hash);
+  for (std::uint64_t v : {version, std::uint64_t{sizeof(R)}, std::uint64_t{alignof(R)}}) {
+    hash = image_hash(std::string_view(reinterpret_cast<const char *>(&v), sizeof(v)), hash);
+  }
+  return hash;
+}
+
+// Arguments are hashed by value, which is only defined for arithmetic types, enums and strings.
+template <typename Arg>
+std::uint64_t image_hash_argument(const Arg &arg, std::uint64_t hash) {
+  hash = image_hash(type_name<Arg>(), hash);
+  if constexpr (std::is_convertible_v<const Arg &, std::string_view>) {
+    std::string_view text = arg;
+    std::uint64_t size = text.size();
+    hash = image_hash(std::string_view(reinterpret_cast<const char *>(&size), sizeof(size)), hash);
+    return image_hash(text, hash);
+  } else {
+    static_assert(std::is_arithmetic_v<Arg> || std::is_enum_v<Arg>,
+                  "arguments of a dag image must be arithmetic types, enums or strings.");
+    return image_hash(std::string_view(reinterpret_cast<const char *>(&arg), sizeof(arg)), hash);
+  }
+}
+
+// Writes the graph rooted at `root` to `path`. The graph must live entirely in `arena` and have
+// been built by a factory whose Creater is an ImageCreater, see is_image_creater.
+template <typename R, typename TypeToSelect = Nothing>
+bool save_image(const char *path, std::uint64_t hash, const ArenaResource &arena, const R &root,
+                const std::pmr::vector<TypeToSelect *> *selections = nullptr) {
+  if (arena.spilled() != 0 || !arena.owns(&root)) {
+    return false;
+  }
+  ImageHeader header;
+  header.hash = hash;
+  header.size = arena.used();
+  header.root = reinterpret_cast<const std::byte *>(&root) - arena.data();
+  std::vector<std::uint64_t> offsets;
+  if (selections != nullptr) {
+    for (TypeToSelect *selected : *selections) {
+      if (!arena.owns(selected)) {
+        return false;
+      }
+      offsets.push_back(reinterpret_cast<const std::byte *>(selected) - arena.data());
+    }
+  }
+  header.selections = offsets.size();
+  if (sizeof(header) + offsets.size() * sizeof(std::uint64_t) > ImageHeader::kPayload) {
+    return false;
+  }
+
+  std::FILE *file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::vector<char> prefix(ImageHeader::kPayload, 0);
+  std::memcpy(prefix.data(), &header, sizeof(header));
+  if (!offsets.empty()) {
+    std::memcpy(prefix.data() + sizeof(header), offsets.data(),
+                offsets.size() * sizeof(std::uint64_t));
+  }
+  bool ok = std::fwrite(prefix.data(), 1, prefix.size(), file) == prefix.size() &&
+            std::fwrite(arena.data(), 1, header.size, file) == header.size;
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    std::remove(path);
+  }
+  return ok;
+}
+
+template <typename TypeToSelect>
+struct MappedDag : public Dag<TypeToSelect> {
+  MappedDag(void *mapping, std::size_t size) : m_mapping(mapping), m_size(size) {}
+  ~MappedDag() override {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_mapping);
+#else
+    munmap(m_mapping, m_size);
+#endif
+  }
+  MappedDag &operator=(MappedDag &&) = delete;
+  const std::pmr::vector<TypeToSelect *> &selections() const override { return m_entryPoints; }
+  void release(void *) override { delete this; }
+
+  void *m_mapping;
+  std::size_t m_size;
+  std::pmr::vector<TypeToSelect *> m_entryPoints;
+};
+
+inline std::pair<void *, std::size_t> map_image(const char *path) {
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return {nullptr, 0};
+  }
+  LARGE_INTEGER size;
+  void *mapping = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    HANDLE view = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (view != nullptr) {
+      mapping = MapViewOfFile(view, FILE_MAP_COPY, 0, 0, 0);
+      CloseHandle(view);
+    }
+  }
+  CloseHandle(file);
+  return {mapping, mapping == nullptr ? 0 : static_cast<std::size_t>(size.QuadPart)};
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return {nullptr, 0};
+  }
+  struct stat info;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    mapping = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return {nullptr, 0};
+  }
+  return {mapping, static_cast<std::size_t>(info.st_size)};
+#endif
+}
+
+// Whether a T at `offset` of a payload of `size` bytes lies entirely within it and is aligned.
+// The payload starts on a page boundary, so the offset alone decides the alignment.
+template <typename T>
+bool image_holds(std::uint64_t offset, std::uint64_t size) {
+  return offset <= size && size - offset >= sizeof(T) && offset % alignof(T) == 0;
+}
+
+// Maps the image at `path` copy-on-write, so the graph can be modified like a created one without
+// touching the file. Returns an empty root if it is missing, damaged or was saved with another
+// hash. Releasing the root unmaps the image; no destructor is run.
+template <typename R, typename TypeToSelect = Nothing>
+std::pair<unique_ptr<R>, const std::pmr::vector<TypeToSelect *> *> load_image(const char *path,
+                                                                              std::uint64_t hash) {
+  auto [mapping, size] = map_image(path);
+  if (mapping == nullptr) {
+    return {nullptr, nullptr};
+  }
+  auto dag = new MappedDag<TypeToSelect>(mapping, size);
+  ImageHeader header;
+  if (size >= ImageHeader::kPayload) {
+    std::memcpy(&header, mapping, sizeof(header));
+  }
+  auto payload = static_cast<std::byte *>(mapping) + ImageHeader::kPayload;
+  if (size < ImageHeader::kPayload || header.magic != ImageHeader::kMagic || header.hash != hash ||
+      header.size > size - ImageHeader::kPayload || !image_holds<R>(header.root, header.size) ||
+      header.selections > (ImageHeader::kPayload - sizeof(header)) / sizeof(std::uint64_t)) {
+    delete dag;
+    return {nullptr, nullptr};
+  }
+  auto offsets = reinterpret_cast<const std::uint64_t *>(static_cast<std::byte *>(mapping) +
+                                                         sizeof(header));
+  for (std::uint64_t i = 0; i < header.selections; ++i) {
+    if (!image_holds<TypeToSelect>(offsets[i], header.size)) {
+      delete dag;
+      return {nullptr, nullptr};
+    }
+    dag->m_entryPoints.push_back(reinterpret_cast<TypeToSelect *>(payload + offsets[i]));
+  }
+  auto root = reinterpret_cast<R *>(payload + header.root);
+  return {unique_ptr<R>(root, DagDeleter{dag}), &dag->selections()};
+}
+
+// Maps the image of the graph at `path` when it matches the Blueprint, `version` and `args`.
+// Otherwise the graph is built by `factory`, which must allocate from `arena`, and saved to `path`
+// for the next run. Returns what factory.create() returns.
+template <typename Factory, typename F, typename... Args>
+auto load_or_create(Factory &factory, const ArenaResource &arena, const char *path,
+                    std::uint64_t version, F initializer, Args &&...args) {
+  static_assert(is_image_creater<typename Factory::Extensions::Creater>::value,
+                "load_or_create() needs a factory that creates its nodes with ImageCreater.");
+  using BP = typename Factory::BP;
+  using TypeToSelect = typename BP::TypeToSelect;
+  using R = std::remove_reference_t<std::invoke_result_t<F, BP *>>;
+  std::uint64_t hash = image_hash<BP, R, TypeToSelect>(version);
+  ((hash = image_hash_argument<std::decay_t<Args>>(args, hash)), ...);
+
+  auto image = load_image<R, TypeToSelect>(path, hash);
+  if constexpr (std::is_same_v<TypeToSelect, Nothing>) {
+    if (image.first != nullptr) {
+      return std::move(image.first);
+    }
+    auto created = factory.create(initializer, std::forward<Args>(args)...);
+    save_image(path, hash, arena, *created);
+    return created;
+  } else {
+    if (image.first != nullptr) {
+      return image;
+    }
+    auto created = factory.create(initializer, std::forward<Args>(args)...);
+    save_image(path, hash, arena, *created.first, created.second);
+    return created;
+  }
+}
+}  // namespace dag
@@ -1,7 +1,12 @@
 #include <catch2/catch_test_macros.hpp>
+#include <chrono>
 #include <map>
+#include <stdexcept>
+#include <thread>
 
+#include "dag/arena_resource.h"
 #include "dag/dag_factory.h"
+#include "dag/dag_image.h"
 
 using namespace dag;
 namespace {
@@ -273,4 +278,651 @@ TEST_CASE("creater is called for every node", "Blueprint") {
   auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
   REQUIRE(creater.called == 5);
   REQUIRE(selections->size() == 2);
-}
\ No newline at end of file
+}
+//------------------------------------------------------------------------------
+TEST_CASE("arena resource holds the whole graph in its reserved region", "Resource") {
+  ArenaResource arena(1 << 20, ArenaOptions{true, true});
+  auto factory = DagFactory<System4, Select<std::pmr::vector<std::pmr::string>>>(&arena);
+  {
+    auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->a(); });
+
+    REQUIRE(arena.owns(entry.get()));
+    REQUIRE(arena.owns((*selections)[0]->data()));
+    REQUIRE(arena.used() > 0);
+  }
+  REQUIRE(arena.used() == 0);  // the region is rewound once the graph is torn down
+}
+
+TEST_CASE("arena resource forwards requests that do not fit to upstream", "Resource") {
+  ArenaResource arena(4096);
+  void *big = arena.allocate(arena.capacity() + 1);
+  REQUIRE_FALSE(arena.owns(big));
+  arena.deallocate(big, arena.capacity() + 1);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("a factory can be shared across threads with per-thread extensions", "Concurrency") {
+  PerThread<std::pmr::synchronized_pool_resource> memory;
+  PerThread<MyIntercepter> intercepter;
+  auto factory = DagFactory<System8, Select<A>, PerThread<MyIntercepter>>(memory, intercepter);
+
+  constexpr int threads = 4;
+  constexpr int graphs = 100;
+  std::atomic<int> selected{0};
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&factory, &selected] {
+      for (int j = 0; j < graphs; ++j) {
+        auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+        selected += static_cast<int>(selections->size());
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  REQUIRE(selected == threads * graphs * 2);
+
+  int called = 0;
+  int instances = 0;
+  intercepter.for_each([&](MyIntercepter &local) {
+    called += local.called;
+    ++instances;
+  });
+  REQUIRE(instances == threads);
+  REQUIRE(called == threads * graphs * 5);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+struct BIntercepter {
+  int called = 0;
+  dag::unique_ptr<B> after_create(std::pmr::memory_resource *memory, dag::unique_ptr<B> v) {
+    ++called;
+    return std::move(v);
+  }
+};
+struct ACreater {
+  int called = 0;
+  template <typename T, typename... Args, typename = std::enable_if_t<std::is_same_v<T, A>>>
+  dag::unique_ptr<T> create(std::pmr::memory_resource *memory, Args &&...args) {
+    ++called;
+    return dag::make_unique_on_memory<T>(memory, std::forward<Args>(args)...);
+  }
+};
+}  // namespace
+
+TEST_CASE("chained intercepters run every stage that handles the node type", "Extension") {
+  using Intercepters = Chain<MyIntercepter, DefaultIntercepter, BIntercepter>;
+  Intercepters intercepter;
+  auto factory =
+      DagFactory<System8, Select<A>, Intercepters>(std::pmr::get_default_resource(), intercepter);
+  auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+  REQUIRE(intercepter.get<MyIntercepter>().called == 5);
+  REQUIRE(intercepter.get<BIntercepter>().called == 1);
+  REQUIRE(selections->size() == 2);
+}
+
+TEST_CASE("chained creaters use the first stage able to create the node type", "Extension") {
+  using Creaters = Chain<ACreater, MyCreater>;
+  Creaters creater;
+  auto factory = DagFactory<System8, Select<A>, DefaultIntercepter, Creaters>(
+      std::pmr::get_default_resource(), DefaultIntercepter::instance(), creater);
+  auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+  REQUIRE(creater.get<ACreater>().called == 2);
+  REQUIRE(creater.get<MyCreater>().called == 3);
+}
+
+TEST_CASE("chains skip per-thread stages that do not handle the node type", "Extension") {
+  using Intercepters = Chain<PerThread<BIntercepter>>;
+  using Creaters = Chain<PerThread<ACreater>>;
+  Intercepters intercepter;
+  Creaters creater;
+  auto factory = DagFactory<System8, Select<A>, Intercepters, Creaters>(
+      std::pmr::get_default_resource(), intercepter, creater);
+  auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+  int intercepted = 0;
+  intercepter.get<0>().for_each([&](BIntercepter &stage) { intercepted += stage.called; });
+  int created = 0;
+  creater.get<0>().for_each([&](ACreater &stage) { created += stage.called; });
+  REQUIRE(intercepted == 1);
+  REQUIRE(created == 2);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+struct Counter {
+  int value = 0;
+  void dag_reset() { value = 0; }
+};
+struct Total {
+  explicit Total(Counter &c) : counter(c) {}
+  Counter &counter;
+  int resets = 0;
+  void dag_reset() {
+    REQUIRE(counter.value == 0);  // dependencies are reset first
+    ++resets;
+  }
+};
+
+struct Ctx {
+  int id;
+  bool operator==(const Ctx &other) const { return id == other.id; }
+};
+struct Session {
+  explicit Session(Ctx &ctx) : ctx(ctx) {}
+  Ctx &ctx;
+  void dag_reset() {}
+};
+
+template <typename T>
+struct Recyclable : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  Counter &counter() dag_shared { return make_node<Counter>(); }
+  Total &total() { return make_node<Total>(counter()); }
+  B &b() { return make_node<B>(make_node<A>()); }
+};
+
+template <typename T>
+struct PerRequest : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  explicit PerRequest(Ctx &ctx) : ctx(ctx) {}
+  Ctx &ctx;
+  Session &session() { return make_node<Session>(ctx); }
+};
+
+template <typename BP>
+Total &totalOf(BP *bp) {
+  return bp->total();
+}
+template <typename BP>
+Total &totalAfterCounter(BP *bp) {
+  bp->counter();
+  return bp->total();
+}
+}  // namespace
+
+TEST_CASE("recycled graphs are reset in place and returned by the next create()", "Recycling") {
+  auto factory = DagFactory<Recyclable, Select<Counter>>();
+  factory.enable_recycling();
+  auto total = [](auto bp) -> auto & { return bp->total(); };
+  Total *first = nullptr;
+  {
+    auto [entry, selections] = factory.create(total);
+    entry->counter.value = 42;
+    first = entry.get();
+  }
+  auto [entry, selections] = factory.create(total);
+  REQUIRE(entry.get() == first);
+  REQUIRE(entry->counter.value == 0);
+  REQUIRE(entry->resets == 1);
+  REQUIRE(selections->size() == 1);
+
+  auto [other, otherSelections] = factory.create(total);
+  REQUIRE(other.get() != first);  // the recycled graph is already in use
+}
+
+TEST_CASE("graphs with nodes that can not be reset are rebuilt", "Recycling") {
+  MyCreater creater;
+  auto factory = DagFactory<Recyclable, Select<Counter>, DefaultIntercepter, MyCreater>(
+      std::pmr::get_default_resource(), DefaultIntercepter::instance(), creater);
+  factory.enable_recycling();
+  auto b = [](auto bp) -> auto & { return bp->b(); };
+  for (int i = 0; i < 2; ++i) {
+    auto entry = factory.create(b);
+  }
+  REQUIRE(creater.called == 4);
+}
+
+TEST_CASE("graphs released after their factory are destroyed instead of recycled", "Recycling") {
+  auto factory = std::make_unique<DagFactory<Recyclable, Select<Counter>>>();
+  factory->enable_recycling();
+  auto total = [](auto bp) -> auto & { return bp->total(); };
+  auto pooled = factory->create(total);
+  auto [entry, selections] = factory->create(total);
+  pooled.first.reset();
+  factory.reset();
+  entry.reset();
+  REQUIRE(entry == nullptr);
+}
+
+TEST_CASE("recycled graphs are told apart by the initializer, not only by its type", "Recycling") {
+  using Factory = DagFactory<Recyclable, Select<Counter>>;
+  Factory factory;
+  factory.enable_recycling();
+  Total *first = factory.create(&totalOf<Factory::BP>).first.get();
+  auto [entry, selections] = factory.create(&totalAfterCounter<Factory::BP>);
+  REQUIRE(entry.get() != first);
+  REQUIRE(factory.create(&totalOf<Factory::BP>).first.get() == first);
+}
+
+TEST_CASE("recycled graphs are only returned for the same lvalue arguments", "Recycling") {
+  auto factory = DagFactory<PerRequest>();
+  factory.enable_recycling();
+  auto session = [](auto bp) -> auto & { return bp->session(); };
+  Ctx first{1};
+  Ctx second{1};
+  Session *built = factory.create(session, first).get();
+  auto entry = factory.create(session, second);
+  REQUIRE(&entry->ctx == &second);
+  entry.reset();
+  REQUIRE(factory.create(session, first).get() == built);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+template <typename T>
+struct Tagged : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  A &a() dag_shared { return make_node<A>(Tag{"shared"}); }
+  B &b() { return make_node<B>(a()); }
+  C &c() { return make_node<C>(make_node<A>(Tag{"private"}), b()); }
+  D &d() { return make_node<D>(b(), c()); }
+};
+}  // namespace
+
+TEST_CASE("indexed dags find nodes by type and by tag", "Index") {
+  auto factory = DagFactory<Tagged>();
+  factory.enable_index();
+  auto entry = factory.create([](auto bp) -> auto & { return bp->d(); });
+  const DagBase *dag = graph_of(entry);
+
+  REQUIRE(dag != nullptr);
+  REQUIRE(dag->find<D>() == entry.get());
+  REQUIRE(dag->all<A>().size() == 2);
+  REQUIRE(dag->all<B>().size() == 2);
+  REQUIRE(dag->find<A>("private") == &dag->all<A>()[1]);
+  REQUIRE(dag->find<A>("shared") == dag->find<A>());
+  REQUIRE(dag->find<B>("shared") == nullptr);
+  REQUIRE(dag->all<std::string>().empty());
+}
+
+TEST_CASE("looking up a tag does not allocate", "Index") {
+  auto factory = DagFactory<Tagged>();
+  factory.enable_index();
+  auto entry = factory.create([](auto bp) -> auto & { return bp->d(); });
+  const DagBase *dag = graph_of(entry);
+
+  auto previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  A *found = dag->find<A>("a tag too long for the small string buffer");
+  A *shared = dag->find<A>("shared");
+  std::pmr::set_default_resource(previous);
+  REQUIRE(found == nullptr);
+  REQUIRE(shared == &dag->all<A>()[0]);
+}
+
+TEST_CASE("dags are not indexed unless the factory enables it", "Index") {
+  auto factory = DagFactory<Tagged>();
+  auto entry = factory.create([](auto bp) -> auto & { return bp->d(); });
+  REQUIRE(graph_of(entry)->find<D>() == nullptr);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+struct Limits {
+  static constexpr bool dag_relocatable = true;
+  explicit Limits(int max) : max(max) {}
+  int max;
+};
+struct Table {
+  static constexpr bool dag_relocatable = true;
+  explicit Table(Limits &limits) : limits(limits) {
+    for (int i = 0; i < 16; ++i) {
+      values[i] = i * limits.max;
+    }
+  }
+  RelPtr<Limits> limits;
+  int values[16];
+};
+
+template <typename T>
+struct Config : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  Limits &limits() dag_shared { return make_node<Limits>(7); }
+  Table &table() { return make_node<Table>(limits()); }
+};
+
+template <typename T>
+struct SizedConfig : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  explicit SizedConfig(int max) : max(max) {}
+  int max;
+  Limits &limits() { return make_node<Limits>(max); }
+};
+
+template <typename T>
+struct Shards : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  NodeArray<Limits> &limits() { return make_node_array<Limits>(4, 3); }
+};
+}  // namespace
+
+TEST_CASE("dag images are saved once and mapped by later runs", "Image") {
+  static_assert(is_image_creater<Chain<ImageCreater, MyCreater>>::value);
+  static_assert(!is_image_creater<Chain<MyCreater, ImageCreater>>::value);
+  static_assert(!is_image_creater<DefaultCreater>::value);
+  const char *path = "dag_image_test.img";
+  std::remove(path);
+  auto table = [](auto bp) -> auto & { return bp->table(); };
+  {
+    ArenaResource arena(1 << 20);
+    auto factory = DagFactory<Config, Select<Limits>, DefaultIntercepter, ImageCreater>(
+        &arena, DefaultIntercepter::instance(), ImageCreater::instance());
+    auto [entry, selections] = load_or_create(factory, arena, path, 1, table);
+    REQUIRE(arena.owns(entry.get()));
+  }
+  {
+    ArenaResource arena(1 << 20);
+    auto factory = DagFactory<Config, Select<Limits>, DefaultIntercepter, ImageCreater>(
+        &arena, DefaultIntercepter::instance(), ImageCreater::instance());
+    auto [entry, selections] = load_or_create(factory, arena, path, 1, table);
+    REQUIRE_FALSE(arena.owns(entry.get()));
+    REQUIRE(arena.used() == 0);
+    REQUIRE(entry->limits->max == 7);
+    REQUIRE(entry->values[3] == 21);
+    REQUIRE(selections->size() == 1);
+    REQUIRE((*selections)[0] == entry->limits.get());
+    entry->values[3] = 0;  // the image is mapped copy-on-write
+    REQUIRE(entry->values[3] == 0);
+  }
+  {
+    ArenaResource arena(1 << 20);
+    auto factory = DagFactory<Config, Select<Limits>, DefaultIntercepter, ImageCreater>(
+        &arena, DefaultIntercepter::instance(), ImageCreater::instance());
+    auto [entry, selections] = load_or_create(factory, arena, path, 2, table);
+    REQUIRE(arena.owns(entry.get()));  // another version rebuilds the graph
+  }
+  std::remove(path);
+}
+
+TEST_CASE("damaged dag images are rebuilt", "Image") {
+  const char *path = "dag_image_damaged_test.img";
+  std::remove(path);
+  auto table = [](auto bp) -> auto & { return bp->table(); };
+  for (int run = 0; run < 2; ++run) {
+    ArenaResource arena(1 << 20);
+    auto factory = DagFactory<Config, Select<Limits>, DefaultIntercepter, ImageCreater>(
+        &arena, DefaultIntercepter::instance(), ImageCreater::instance());
+    auto [entry, selections] = load_or_create(factory, arena, path, 1, table);
+    REQUIRE(arena.owns(entry.get()));
+    REQUIRE(entry->values[3] == 21);
+    if (run == 0) {
+      // points the root at the last byte of the payload, where a Table does not fit.
+      std::FILE *file = std::fopen(path, "r+b");
+      ImageHeader header;
+      REQUIRE(std::fread(&header, sizeof(header), 1, file) == 1);
+      header.root = header.size - 1;
+      std::rewind(file);
+      REQUIRE(std::fwrite(&header, sizeof(header), 1, file) == 1);
+      std::fclose(file);
+    }
+  }
+  std::remove(path);
+}
+
+TEST_CASE("dag images are rebuilt for other Blueprint arguments", "Image") {
+  const char *path = "dag_image_args_test.img";
+  std::remove(path);
+  auto limits = [](auto bp) -> auto & { return bp->limits(); };
+  int previous = 0;
+  for (int max : {1, 2, 2}) {
+    ArenaResource arena(1 << 20);
+    auto factory = DagFactory<SizedConfig, Select<Nothing>, DefaultIntercepter, ImageCreater>(
+        &arena, DefaultIntercepter::instance(), ImageCreater::instance());
+    auto entry = load_or_create(factory, arena, path, 1, limits, max);
+    REQUIRE(entry->max == max);
+    REQUIRE(arena.owns(entry.get()) == (max != previous));  // mapped only for the same argument
+    previous = max;
+  }
+  std::remove(path);
+}
+
+TEST_CASE("arrays of relocatable nodes can be saved in dag images", "Image") {
+  static_assert(is_relocatable<NodeArray<Limits>>::value);
+  static_assert(!is_relocatable<NodeArray<std::pmr::string>>::value);
+  const char *path = "dag_array_image_test.img";
+  std::remove(path);
+  for (int run = 0; run < 2; ++run) {
+    ArenaResource arena(1 << 20);
+    auto factory = DagFactory<Shards, Select<Nothing>, DefaultIntercepter, ImageCreater>(
+        &arena, DefaultIntercepter::instance(), ImageCreater::instance());
+    auto entry = load_or_create(factory, arena, path, 1, [](auto bp) -> auto & {
+      return bp->limits();
+    });
+    REQUIRE(arena.owns(entry.get()) == (run == 0));  // the second run maps the image
+    REQUIRE(entry->size() == 4);
+    REQUIRE((*entry)[3].max == 3);
+  }
+  std::remove(path);
+}
+
+//------------------------------------------------------------------------------
+namespace {
+template <typename T>
+struct Duplicating : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  A &a() { return make_node<A>(); }
+  B &b() { return make_node<B>(a()); }
+  int &limit() { return make_node<int>(100); }
+  D &d() {
+    limit();
+    limit();
+    make_node<int>(200);
+    return make_node<D>(b(), make_node<C>(a(), b()));
+  }
+};
+
+template <typename T>
+struct Replicated : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  B &b() {
+    make_node<A>(Tag{"primary"});
+    return make_node<B>(make_node<A>(Tag{"replica"}));
+  }
+};
+
+template <typename T>
+struct Looping : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  A &a() {
+    for (int i = 0; i < 4; ++i) {
+      make_node<int>(i);
+    }
+    int limit = 5;
+    make_node<int>(limit);
+    make_node<int>(limit);
+    return make_node<A>();
+  }
+};
+}  // namespace
+
+TEST_CASE("redundant nodes are reported by type", "Redundancy") {
+  RedundancyReport report;
+  auto factory = DagFactory<Duplicating, Select<A>>();
+  factory.detect_redundancy(report);
+  auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+
+  REQUIRE(selections->size() == 3);
+  auto entries = report.entries();
+  REQUIRE(entries.size() == 2);
+  for (auto &redundancy : entries) {
+    if (redundancy.type == type_name<A>()) {
+      REQUIRE(redundancy.duplicates == 2);  // B's of different A's are not duplicates
+    } else {
+      REQUIRE(redundancy.type == type_name<int>());
+      REQUIRE(redundancy.duplicates == 1);
+    }
+  }
+  REQUIRE(report.bytes() == 2 * sizeof(A) + sizeof(int));
+}
+
+TEST_CASE("redundant nodes can be coalesced", "Redundancy") {
+  RedundancyReport report;
+  auto factory = DagFactory<Duplicating, Select<A>>();
+  factory.detect_redundancy(report, true);
+  auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->d(); });
+
+  REQUIRE(selections->size() == 1);
+  auto entries = report.entries();
+  REQUIRE(entries.size() == 3);  // once A's are shared, so are the B's made of them
+}
+
+TEST_CASE("nodes with different tags are not redundant", "Redundancy") {
+  RedundancyReport report;
+  auto factory = DagFactory<Replicated>();
+  factory.enable_index();
+  factory.detect_redundancy(report, true);
+  auto entry = factory.create([](auto bp) -> auto & { return bp->b(); });
+  const DagBase *dag = graph_of(entry);
+
+  REQUIRE(report.entries().empty());
+  REQUIRE(dag->all<A>().size() == 2);
+  REQUIRE(dag->find<A>("replica") == &dag->all<A>()[1]);
+}
+
+TEST_CASE("arguments that are not nodes are compared by value", "Redundancy") {
+  RedundancyReport report;
+  auto factory = DagFactory<Looping, Select<int>>();
+  factory.detect_redundancy(report, true);
+  auto [entry, selections] = factory.create([](auto bp) -> auto & { return bp->a(); });
+
+  REQUIRE(selections->size() == 5);
+  for (int i = 0; i < 5; ++i) {
+    REQUIRE(*(*selections)[i] == (i < 4 ? i : 5));
+  }
+  auto entries = report.entries();
+  REQUIRE(entries.size() == 1);
+  REQUIRE(entries[0].duplicates == 1);  // the same local variable, with the same value
+}
+
+//------------------------------------------------------------------------------
+namespace {
+struct Worker {
+  Worker(ArrayIndex index, A &a, std::vector<int> &destroyed)
+      : destroyed(destroyed), id(static_cast<int>(index.value)) {
+    if (id == failAt) {
+      throw std::runtime_error("worker failed");
+    }
+  }
+  ~Worker() { destroyed.push_back(id); }
+  std::vector<int> &destroyed;
+  int id;
+  static inline int failAt = -1;
+};
+
+template <typename T>
+struct Workers : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  explicit Workers(std::vector<int> &destroyed) : destroyed(destroyed) {}
+  std::vector<int> &destroyed;
+  A &a() dag_shared { return make_node<A>(); }
+  NodeArray<Worker> &workers() { return make_node_array<Worker>(4, a(), destroyed); }
+};
+}  // namespace
+
+TEST_CASE("make_node_array() builds nodes contiguously and destroys them in reverse", "Array") {
+  std::vector<int> destroyed;
+  {
+    auto factory = DagFactory<Workers, Select<NodeArray<Worker>>>();
+    auto [entry, selections] =
+        factory.create([](auto bp) -> auto & { return bp->workers(); }, destroyed);
+
+    REQUIRE(selections->size() == 1);
+    REQUIRE((*selections)[0] == entry.get());
+    REQUIRE(entry->size() == 4);
+    for (std::size_t i = 0; i < entry->size(); ++i) {
+      REQUIRE(&(*entry)[i] == entry->data() + i);
+      REQUIRE((*entry)[i].id == static_cast<int>(i));
+    }
+  }
+  REQUIRE(destroyed == std::vector<int>{3, 2, 1, 0});
+}
+
+TEST_CASE("make_node_array() destroys the nodes already built when one fails", "Array") {
+  std::vector<int> destroyed;
+  Worker::failAt = 2;
+  auto factory = DagFactory<Workers>();
+  REQUIRE_THROWS(factory.create([](auto bp) -> auto & { return bp->workers(); }, destroyed));
+  Worker::failAt = -1;
+  REQUIRE(destroyed == std::vector<int>{1, 0});
+}
+
+TEST_CASE("make_node_array() records the time spent building the array", "Array") {
+  std::vector<int> destroyed;
+  std::vector<NodeTiming> timings;
+  BuildLimits limits;
+  limits.timings = &timings;
+  auto factory = DagFactory<Workers>();
+  auto result =
+      factory.create(limits, [](auto bp) -> auto & { return bp->workers(); }, destroyed);
+
+  REQUIRE(result);
+  REQUIRE(timings.size() == 2);
+  REQUIRE(timings[0].type == type_name<A>());
+  REQUIRE(timings[1].type == type_name<NodeArray<Worker>>());
+}
+
+//------------------------------------------------------------------------------
+namespace {
+struct Slow {
+  explicit Slow(std::vector<int> &destroyed) : destroyed(destroyed) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ~Slow() { destroyed.push_back(1); }
+  std::vector<int> &destroyed;
+};
+
+template <typename T>
+struct SlowSystem : public Blueprint<T> {
+  DAG_TEMPLATE_HELPER()
+  explicit SlowSystem(std::vector<int> &destroyed) : destroyed(destroyed) {}
+  std::vector<int> &destroyed;
+  Slow &slow() { return make_node<Slow>(destroyed); }
+  std::pair<Slow *, Slow *> &pair() {
+    return make_node<std::pair<Slow *, Slow *>>(&slow(), &slow());
+  }
+  std::pair<Slow *, Slow *> &expiring(BuildLimits &limits) {
+    Slow *first = &slow();
+    limits.deadline = std::chrono::steady_clock::time_point::min();
+    return make_node<std::pair<Slow *, Slow *>>(first, &slow());
+  }
+};
+}  // namespace
+
+TEST_CASE("create() gives up once the deadline has passed", "Limits") {
+  std::vector<int> destroyed;
+  std::vector<NodeTiming> timings;
+  BuildLimits limits;
+  limits.deadline = std::chrono::steady_clock::now() + std::chrono::hours(1);
+  limits.timings = &timings;
+  auto factory = DagFactory<SlowSystem>();
+  // the deadline passes once the first node is built.
+  auto expiring = [&limits](auto bp) -> auto & { return bp->expiring(limits); };
+  auto result = factory.create(limits, expiring, destroyed);
+
+  REQUIRE_FALSE(result);
+  REQUIRE(result.status == BuildStatus::TimedOut);
+  REQUIRE(result.graph == nullptr);
+  REQUIRE(destroyed.size() == 1);  // the node built before the deadline is torn down
+  REQUIRE(timings.size() == 1);
+  REQUIRE(timings[0].type == type_name<Slow>());
+  REQUIRE(timings[0].elapsed >= std::chrono::milliseconds(5));
+}
+
+TEST_CASE("create() stops when cancelled and builds normally otherwise", "Limits") {
+  std::vector<int> destroyed;
+  CancellationToken token;
+  BuildLimits limits;
+  limits.token = &token;
+  auto factory = DagFactory<SlowSystem>();
+  auto pair = [](auto bp) -> auto & { return bp->pair(); };
+
+  auto built = factory.create(limits, pair, destroyed);
+  REQUIRE(built);
+  REQUIRE(built.graph->first != built.graph->second);
+
+  token.cancel();
+  auto cancelled = factory.create(limits, pair, destroyed);
+  REQUIRE(cancelled.status == BuildStatus::Cancelled);
+  REQUIRE(destroyed.empty());
+}